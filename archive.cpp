@@ -0,0 +1,433 @@
+#include <vector>
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include "archive.h"
+
+namespace fs = std::filesystem;
+
+// marks the end of a valid archive (after decryption)
+constexpr char archive_magic[8] = {'C', 'P', 'P', 'E', 'N', 'C', 'A', 'R'};
+
+// size of the trailer - index offset (8), entry count (8), magic (8)
+constexpr std::size_t trailer_size = 24;
+
+// size of an index entry before its path - offset (8), length (8), path length (4)
+constexpr std::size_t entry_header_size = 20;
+
+// represents a single file in the archive
+struct archive_entry_t
+{
+	std::string   path;   // member path (relative, '/' separated)
+	std::uint64_t offset; // position of the member's data in the archive
+	std::uint64_t length; // length of the member's data
+};
+
+// -------------------------------
+
+// appends a little-endian integer of the given size (in bytes) to the string
+void put_uint(std::string &dest, std::uint64_t v, int size)
+{
+	for (int i = 0; i < size; ++i, v >>= 8) dest.push_back((char)(v & 0xff));
+}
+// reads a little-endian integer of the given size (in bytes) from the data
+std::uint64_t get_uint(const char *data, int size)
+{
+	std::uint64_t v = 0;
+	for (int i = size - 1; i >= 0; --i) v = (v << 8) | (unsigned char)data[i];
+	return v;
+}
+
+// -------------------------------
+
+// batches many (potentially tiny) writes into full buffers, encrypting each buffer as one continuous stream
+struct archive_writer_t
+{
+	std::ostream   &out;    // the archive stream
+	ParallelCrypto &worker; // the worker to encrypt with (continues from the previous buffer)
+	char           *buffer; // the buffer to collect data in
+	int             buflen; // the length of the buffer
+
+	int           fill = 0; // number of bytes currently in the buffer
+	std::uint64_t pos = 0;  // archive position of the start of the buffer
+
+	// gets the archive position of the next byte to be written
+	std::uint64_t tell() const noexcept { return pos + fill; }
+
+	// encrypts and writes out the contents of the buffer
+	void flush()
+	{
+		if (fill == 0) return;
+
+		worker.process(buffer, 0, fill);
+		out.write(buffer, fill);
+
+		pos += fill;
+		fill = 0;
+	}
+
+	// appends the data to the archive
+	void write(const char *data, std::size_t len)
+	{
+		while (len > 0)
+		{
+			int n = (int)std::min<std::size_t>(len, buflen - fill);
+			std::memcpy(buffer + fill, data, n);
+
+			fill += n;
+			data += n;
+			len -= n;
+
+			if (fill == buflen) flush();
+		}
+	}
+	// appends the remaining contents of the input stream to the archive (reading directly into the buffer).
+	// returns the number of bytes written
+	std::uint64_t write(std::istream &in)
+	{
+		std::uint64_t len = 0;
+
+		while (true)
+		{
+			in.read(buffer + fill, buflen - fill);
+
+			std::streamsize n = in.gcount();
+			if (n == 0) break;
+
+			fill += (int)n;
+			len += n;
+
+			if (fill == buflen) flush();
+		}
+
+		return len;
+	}
+};
+
+int cryptf_pack(const char *archive_path, const std::vector<const char*> &root_paths, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+{
+	// open the archive
+	std::ofstream out(archive_path, std::ios::trunc | std::ios::binary);
+	if (!out.is_open())
+	{
+		if (log) *log << "FAILURE: failed to open file \"" << archive_path << "\" for writing\n";
+		return 0;
+	}
+
+	std::vector<archive_entry_t> index; // entries for the files added so far
+	std::set<std::string>        names; // member names used so far (each must be unique to be extractable)
+
+	// the archive is one stream starting at position 0
+	worker.reset();
+	archive_writer_t writer{out, worker, buffer, buflen};
+
+	// only a file with the archive's name can be the archive, so look that up once (canonical gives the on-disk spelling)
+	const fs::path archive_name = fs::canonical(archive_path).filename();
+
+	// adds the file at path to the archive under the given member path
+	auto add = [&](const fs::path &path, const fs::path &member)
+	{
+		// don't try to pack the archive into itself
+		if (path.filename() == archive_name && fs::equivalent(path, archive_path)) return;
+
+		// a member name can only be extracted once, so skip anything that collides (e.g. repeated roots or roots with the same name)
+		std::string name = member.generic_string();
+		if (names.count(name) != 0)
+		{
+			if (log) *log << "FAILURE: skipping \"" << path.generic_string() << "\" - archive already has a member \"" << name << "\"\n";
+			return;
+		}
+
+		std::ifstream in(path, std::ios::binary);
+		if (!in.is_open())
+		{
+			if (log) *log << "FAILURE: failed to open file \"" << path.generic_string() << "\" for reading\n";
+			return;
+		}
+
+		if (log) *log << "packing \"" << path.generic_string() << "\"\n";
+
+		archive_entry_t entry;
+		entry.path = name;
+		entry.offset = writer.tell();
+		entry.length = writer.write(in);
+
+		index.push_back(std::move(entry));
+		names.insert(std::move(name));
+	};
+
+	// for each root path
+	for (const char *root_path : root_paths)
+	{
+		// get the canonical form of the root, since its name is used as the top-level member name (e.g. "." or "dir/")
+		fs::path root = fs::absolute(root_path).lexically_normal();
+		if (!root.has_filename()) root = root.parent_path();
+
+		// if it's a file, add it at the top level
+		if (fs::is_regular_file(root)) add(root, root.filename());
+		// if it's a directory, add its contents recursively (relative to its parent)
+		else if (fs::is_directory(root))
+		{
+			for (const fs::directory_entry &entry : fs::recursive_directory_iterator(root))
+			{
+				if (fs::is_regular_file(entry.status())) add(entry.path(), root.filename() / entry.path().lexically_relative(root));
+			}
+		}
+		else if (log) *log << "FAILURE: no such file or directory \"" << root_path << "\"\n";
+	}
+
+	// build the index and trailer
+	std::string tail;
+	for (const archive_entry_t &entry : index)
+	{
+		put_uint(tail, entry.offset, 8);
+		put_uint(tail, entry.length, 8);
+		put_uint(tail, entry.path.size(), 4);
+		tail += entry.path;
+	}
+	put_uint(tail, writer.tell(), 8);
+	put_uint(tail, index.size(), 8);
+	tail.append(archive_magic, sizeof(archive_magic));
+
+	// write them after the data and push everything out
+	writer.write(tail.data(), tail.size());
+	writer.flush();
+
+	if (!out.flush())
+	{
+		if (log) *log << "FAILURE: failed to write archive \"" << archive_path << "\"\n";
+		return 0;
+	}
+
+	return (int)index.size();
+}
+
+// -------------------------------
+
+// reads the given range of the archive into dest and decrypts it. returns true on success
+bool read_range(std::istream &in, ParallelCrypto &worker, std::uint64_t pos, char *dest, std::size_t len)
+{
+	// read the raw data
+	in.clear();
+	in.seekg((std::streamoff)pos);
+	in.read(dest, len);
+	if ((std::size_t)in.gcount() != len) return false;
+
+	// decrypt it from the same position it was encrypted at
+	worker.setpos(pos);
+	for (std::size_t done = 0; done < len; )
+	{
+		int n = (int)std::min<std::size_t>(len - done, INT_MAX);
+		worker.process(dest + done, 0, n);
+		done += n;
+	}
+
+	return true;
+}
+
+// reads and validates the archive's index. returns true on success
+bool read_index(std::istream &in, const char *archive_path, ParallelCrypto &worker, std::vector<archive_entry_t> &index, std::ostream *log)
+{
+	// get the archive size
+	in.seekg(0, in.end);
+	std::uint64_t size = (std::uint64_t)in.tellg();
+
+	// read the trailer - the magic can only be recovered with the right password
+	char trailer[trailer_size];
+	if (size < trailer_size || !read_range(in, worker, size - trailer_size, trailer, trailer_size) || std::memcmp(trailer + 16, archive_magic, sizeof(archive_magic)) != 0)
+	{
+		if (log) *log << "FAILURE: \"" << archive_path << "\" is not an archive (or the password is wrong)\n";
+		return false;
+	}
+
+	std::uint64_t index_off = get_uint(trailer, 8);  // position of the index
+	std::uint64_t count = get_uint(trailer + 8, 8);  // number of entries
+
+	// reports a corrupt archive
+	auto corrupt = [&]()
+	{
+		if (log) *log << "FAILURE: archive \"" << archive_path << "\" is corrupt\n";
+		return false;
+	};
+
+	// read the index
+	if (index_off > size - trailer_size) return corrupt();
+	std::vector<char> raw((std::size_t)(size - trailer_size - index_off));
+	if (!read_range(in, worker, index_off, raw.data(), raw.size())) return corrupt();
+
+	// parse the entries
+	index.clear();
+	index.reserve((std::size_t)std::min<std::uint64_t>(count, raw.size() / entry_header_size));
+	std::size_t pos = 0;
+	for (std::uint64_t i = 0; i < count; ++i)
+	{
+		if (raw.size() - pos < entry_header_size) return corrupt();
+
+		archive_entry_t entry;
+		entry.offset = get_uint(&raw[pos], 8);
+		entry.length = get_uint(&raw[pos + 8], 8);
+		std::size_t path_len = (std::size_t)get_uint(&raw[pos + 16], 4);
+		pos += entry_header_size;
+
+		if (raw.size() - pos < path_len) return corrupt();
+		entry.path.assign(&raw[pos], path_len);
+		pos += path_len;
+
+		// member data must lie before the index
+		if (entry.length > index_off || entry.offset > index_off - entry.length) return corrupt();
+
+		index.push_back(std::move(entry));
+	}
+
+	return true;
+}
+
+// returns true if the member path is safe to extract under a directory (i.e. it can't escape it)
+bool safe_member(const fs::path &path)
+{
+	if (path.empty() || path.has_root_path()) return false;
+	for (const fs::path &part : path) if (part == "..") return false;
+	return true;
+}
+
+// decrypts a single archive entry to the specified file. returns true on success
+bool extract_entry(std::istream &in, const char *archive_path, const archive_entry_t &entry, const fs::path &out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+{
+	// make sure we're not going to save over the archive we're reading from
+	// fs::equivalent() can throw if either path doesn't exist, so we need to check out_path before calling it
+	if (fs::exists(out_path) && fs::equivalent(out_path, archive_path))
+	{
+		if (log) *log << "FAILURE: attempt to save over archive: \"" << entry.path << "\" -> \"" << out_path.generic_string() << "\"\n";
+		return false;
+	}
+
+	// create the parent directories
+	std::error_code ec;
+	if (out_path.has_parent_path()) fs::create_directories(out_path.parent_path(), ec);
+
+	// open the output
+	std::ofstream out(out_path, std::ios::trunc | std::ios::binary);
+	if (!out.is_open())
+	{
+		if (log) *log << "FAILURE: failed to open file \"" << out_path.generic_string() << "\" for writing\n";
+		return false;
+	}
+
+	if (log) *log << "extracting \"" << entry.path << "\" -> \"" << out_path.generic_string() << "\"\n";
+
+	// decrypt just this member's range, starting at its offset in the stream
+	worker.reset();
+	for (std::uint64_t done = 0; done < entry.length; )
+	{
+		int n = (int)std::min<std::uint64_t>(entry.length - done, buflen);
+		if (!read_range(in, worker, entry.offset + done, buffer, n))
+		{
+			if (log) *log << "FAILURE: archive \"" << archive_path << "\" is truncated\n";
+			return false;
+		}
+		out.write(buffer, n);
+		done += n;
+	}
+
+	return true;
+}
+
+// opens the archive and loads its index. returns true on success
+bool open_archive(const char *archive_path, std::ifstream &in, ParallelCrypto &worker, std::vector<archive_entry_t> &index, std::ostream *log)
+{
+	in = std::ifstream(archive_path, std::ios::binary);
+	if (!in.is_open())
+	{
+		if (log) *log << "FAILURE: failed to open file \"" << archive_path << "\" for reading\n";
+		return false;
+	}
+
+	return read_index(in, archive_path, worker, index, log);
+}
+
+int cryptf_unpack(const char *archive_path, const char *out_root, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+{
+	int successes = 0; // number of successful operations
+
+	// open the archive and load the index
+	std::ifstream in;
+	std::vector<archive_entry_t> index;
+	if (!open_archive(archive_path, in, worker, index, log)) return 0;
+
+	// extract each entry
+	for (const archive_entry_t &entry : index)
+	{
+		fs::path member(entry.path);
+		if (!safe_member(member))
+		{
+			if (log) *log << "FAILURE: refusing to extract unsafe member \"" << entry.path << "\"\n";
+			continue;
+		}
+
+		if (extract_entry(in, archive_path, entry, fs::path(out_root) / member, worker, buffer, buflen, log)) ++successes;
+	}
+
+	return successes;
+}
+
+bool cryptf_extract(const char *archive_path, const char *member, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+{
+	// open the archive and load the index
+	std::ifstream in;
+	std::vector<archive_entry_t> index;
+	if (!open_archive(archive_path, in, worker, index, log)) return false;
+
+	// find the member (members are stored in generic form)
+	std::string name = fs::path(member).lexically_normal().generic_string();
+	auto entry = std::find_if(index.begin(), index.end(), [&name](const archive_entry_t &e) { return e.path == name; });
+	if (entry == index.end())
+	{
+		if (log) *log << "FAILURE: archive \"" << archive_path << "\" has no member \"" << member << "\"\n";
+		return false;
+	}
+
+	return extract_entry(in, archive_path, *entry, out_path, worker, buffer, buflen, log);
+}
+int cryptf_extract(const char *archive_path, const std::vector<const char*> &members, const char *out_root, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+{
+	int successes = 0; // number of successful operations
+
+	// open the archive and load the index (once for all members)
+	std::ifstream in;
+	std::vector<archive_entry_t> index;
+	if (!open_archive(archive_path, in, worker, index, log)) return 0;
+
+	// map member names to their entries so each lookup is cheap
+	std::unordered_map<std::string, const archive_entry_t*> lookup;
+	lookup.reserve(index.size());
+	for (const archive_entry_t &entry : index) lookup.emplace(entry.path, &entry);
+
+	// extract each requested member
+	for (const char *member : members)
+	{
+		// find the member (members are stored in generic form)
+		fs::path name = fs::path(member).lexically_normal();
+		auto entry = lookup.find(name.generic_string());
+		if (entry == lookup.end())
+		{
+			if (log) *log << "FAILURE: archive \"" << archive_path << "\" has no member \"" << member << "\"\n";
+			continue;
+		}
+		if (!safe_member(name))
+		{
+			if (log) *log << "FAILURE: refusing to extract unsafe member \"" << member << "\"\n";
+			continue;
+		}
+
+		if (extract_entry(in, archive_path, *entry->second, fs::path(out_root) / name, worker, buffer, buflen, log)) ++successes;
+	}
+
+	return successes;
+}
@@ -0,0 +1,31 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <iostream>
+#include <vector>
+
+#include "encryption.h"
+
+// an archive is a single encrypted file holding an entire directory tree. it consists of:
+// <member data...> <index> <trailer>
+// where the index lists the path, offset and length of each member and the trailer locates the index.
+// the whole file (index and trailer included) is encrypted as one continuous stream, so the tree structure is not exposed.
+// because a byte's encryption only depends on its position, any member can be decrypted without touching the rest.
+
+// packs the contents of the specified paths (files or directories) into a new archive.
+// member names must be unique - files whose names collide with an earlier member are reported and skipped.
+// worker should be in encrypt mode. returns the number of files packed (0 if the archive could not be written)
+int cryptf_pack(const char *archive_path, const std::vector<const char*> &root_paths, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+
+// extracts every member of the archive into the specified directory.
+// worker should be in decrypt mode. returns the number of files extracted
+int cryptf_unpack(const char *archive_path, const char *out_root, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+
+// extracts a single member of the archive to the specified file without decrypting the rest of the archive.
+// worker should be in decrypt mode. returns true if there were no errors
+bool cryptf_extract(const char *archive_path, const char *member, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+// extracts the listed members of the archive into the specified directory, reading the index only once.
+// worker should be in decrypt mode. returns the number of files extracted
+int cryptf_extract(const char *archive_path, const std::vector<const char*> &members, const char *out_root, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+
+#endif
@@ -0,0 +1,155 @@
+#include <cstring>
+
+#include "crc32c.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CRC32C_HW
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#endif
+
+// crc32c polynomial (reversed bit order)
+constexpr std::uint32_t POLY = 0x82f63b78;
+
+// -------------------------------
+
+// lookup table for the software fallback (one entry per byte value)
+struct crc_table_t
+{
+	std::uint32_t t[256];
+
+	crc_table_t() noexcept
+	{
+		for (std::uint32_t i = 0; i < 256; ++i)
+		{
+			std::uint32_t c = i;
+			for (int k = 0; k < 8; ++k) c = c & 1 ? (c >> 1) ^ POLY : c >> 1;
+			t[i] = c;
+		}
+	}
+};
+static const crc_table_t crc_table;
+
+// software crc32c on the raw (non-inverted) crc register
+std::uint32_t crc32c_sw(std::uint32_t crc, const unsigned char *data, std::size_t length) noexcept
+{
+	for (; length > 0; --length, ++data) crc = crc_table.t[(crc ^ *data) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef CRC32C_HW
+// returns true if the processor supports the sse4.2 crc32 instruction
+bool crc32c_hw_supported() noexcept
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	unsigned int a, b, c, d;
+	return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2) != 0;
+#endif
+}
+static const bool crc_hw = crc32c_hw_supported();
+
+// hardware crc32c on the raw (non-inverted) crc register
+CRC32C_TARGET std::uint32_t crc32c_hw(std::uint32_t crc, const unsigned char *data, std::size_t length) noexcept
+{
+	// consume leading bytes until we're aligned for wide reads
+	for (; length > 0 && (reinterpret_cast<std::uintptr_t>(data) & 7) != 0; --length, ++data) crc = _mm_crc32_u8(crc, *data);
+
+#if defined(_M_X64) || defined(__x86_64__)
+	std::uint64_t crc64 = crc;
+	for (; length >= 8; length -= 8, data += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data, sizeof(word)); // memcpy avoids aliasing issues (compiles to a single load)
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (std::uint32_t)crc64;
+#else
+	for (; length >= 4; length -= 4, data += 4)
+	{
+		std::uint32_t word;
+		std::memcpy(&word, data, sizeof(word)); // memcpy avoids aliasing issues (compiles to a single load)
+		crc = _mm_crc32_u32(crc, word);
+	}
+#endif
+
+	// finish off the tail
+	for (; length > 0; --length, ++data) crc = _mm_crc32_u8(crc, *data);
+	return crc;
+}
+#endif
+
+// -------------------------------
+
+// multiplies a and b modulo the crc polynomial (both in reversed bit order)
+std::uint32_t multmodp(std::uint32_t a, std::uint32_t b) noexcept
+{
+	std::uint32_t m = 1u << 31;
+	std::uint32_t p = 0;
+
+	while (true)
+	{
+		if (a & m)
+		{
+			p ^= b;
+			if ((a & (m - 1)) == 0) break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+	}
+
+	return p;
+}
+
+// table of x^(2^n) modulo the crc polynomial for n in [0, 32)
+struct x2n_table_t
+{
+	std::uint32_t t[32];
+
+	x2n_table_t() noexcept
+	{
+		std::uint32_t p = 1u << 30; // x^1
+		t[0] = p;
+		for (int n = 1; n < 32; ++n) t[n] = p = multmodp(p, p);
+	}
+};
+static const x2n_table_t x2n_table;
+
+// returns x^(n * 2^k) modulo the crc polynomial
+std::uint32_t x2nmodp(std::uint64_t n, int k) noexcept
+{
+	std::uint32_t p = 1u << 31; // x^0 == 1
+
+	for (; n; n >>= 1, ++k) if (n & 1) p = multmodp(x2n_table.t[k & 31], p);
+
+	return p;
+}
+
+// -------------------------------
+
+std::uint32_t crc32c(std::uint32_t crc, const char *data, std::size_t length)
+{
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+
+	// the register is kept inverted between calls so that crc = 0 is the starting value
+	crc = ~crc;
+#ifdef CRC32C_HW
+	if (crc_hw) return ~crc32c_hw(crc, bytes, length);
+#endif
+	return ~crc32c_sw(crc, bytes, length);
+}
+
+std::uint32_t crc32c_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t len2)
+{
+	// shift crc1 past len2 bytes of zeros and merge in crc2 (x^(8 * len2) == x^(len2 * 2^3))
+	return multmodp(x2nmodp(len2, 3), crc1) ^ crc2;
+}
@@ -0,0 +1,15 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+
+// updates a crc32c (castagnoli) checksum with the given data. start with crc = 0 for new data.
+// uses the sse4.2 crc32 instruction when the processor supports it, otherwise falls back to a lookup table.
+std::uint32_t crc32c(std::uint32_t crc, const char *data, std::size_t length);
+
+// given crc1 = crc32c(0, A) and crc2 = crc32c(0, B), returns crc32c(0, A + B) where len2 is the length of B.
+// this allows checksums of adjacent slices to be computed separately (e.g. by different threads) and merged afterwards.
+std::uint32_t crc32c_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t len2);
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "encryption.h"
 #include "filesize.h"
+#include "crc32c.h"
 
 namespace fs = std::filesystem;
 
@@ -146,6 +147,9 @@ void decrypt(char *data, const int *masks, int maskc, int offset, int length, in
 
 ParallelCrypto::ParallelCrypto(const char *key, mode m)
 {
+	// no digests by default
+	digests = digest_none;
+
 	// set the password and mode right away cause they can potentially throw (internally calls reset())
 	setkey(key);
 	setmode(m);
@@ -171,8 +175,13 @@ ParallelCrypto::ParallelCrypto(const char *key, mode m)
 				// if we have stuff to do
 				if (workers[i].has_data.load(std::memory_order_acquire))
 				{
-					// process the data
+					char *slice = data + width * i; // our slice of the data
+
+					// process the data (digesting it before and/or after while it's still in cache)
+					if (digests & digest_input) workers[i].in_crc = crc32c(0, slice, width);
 					crypto(data, masks.get(), maskc, width * i, width, (maskoff + width * i) % maskc);
+					if (digests & digest_output) workers[i].out_crc = crc32c(0, slice, width);
+
 					// mark that we did it
 					workers[i].has_data.store(false, std::memory_order_release);
 				}
@@ -212,9 +221,20 @@ void ParallelCrypto::setkey(const char *key)
 	reset();
 }
 
+void ParallelCrypto::setdigest(int d) noexcept
+{
+	digests = d & digest_both;
+}
+
 void ParallelCrypto::reset() noexcept
 {
 	maskoff = 0;
+	in_digest = 0;
+	out_digest = 0;
+}
+void ParallelCrypto::setpos(std::uint64_t pos) noexcept
+{
+	maskoff = pos % maskc;
 }
 void ParallelCrypto::process(char *buffer, int start, int count)
 {
@@ -229,11 +249,29 @@ void ParallelCrypto::process(char *buffer, int start, int count)
 	if (width > 0) for (std::size_t i = 0; i < workerc; ++i) workers[i].has_data.store(true, std::memory_order_release);
 
 	// we do the last slice ourselves
-	crypto(data, masks.get(), maskc, width * workerc, count - width * workerc, (maskoff + width * workerc) % maskc);
+	char         *last = data + width * workerc;  // our slice of the data
+	std::size_t   lastlen = count - width * workerc; // length of our slice
+	std::uint32_t last_in = 0, last_out = 0;      // digests of our slice
+
+	if (digests & digest_input) last_in = crc32c(0, last, lastlen);
+	crypto(data, masks.get(), maskc, width * workerc, (int)lastlen, (maskoff + width * workerc) % maskc);
+	if (digests & digest_output) last_out = crc32c(0, last, lastlen);
 
 	// wait for the workers to finish their stuff
 	for (std::size_t i = 0; i < workerc; ++i) while (workers[i].has_data.load(std::memory_order_acquire)) std::this_thread::yield();
 
+	// merge the slice digests into the running digests in order (workers only ran if width is positive)
+	if (digests & digest_input)
+	{
+		if (width > 0) for (std::size_t i = 0; i < workerc; ++i) in_digest = crc32c_combine(in_digest, workers[i].in_crc, width);
+		in_digest = crc32c_combine(in_digest, last_in, lastlen);
+	}
+	if (digests & digest_output)
+	{
+		if (width > 0) for (std::size_t i = 0; i < workerc; ++i) out_digest = crc32c_combine(out_digest, workers[i].out_crc, width);
+		out_digest = crc32c_combine(out_digest, last_out, lastlen);
+	}
+
 	// bump up offset
 	maskoff = (maskoff + count) % maskc;
 }
@@ -362,7 +400,25 @@ bool openf(const char *path, std::fstream &f, std::ostream *log = nullptr)
 	return true;
 }
 
-bool cryptf(const char *in_path, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+// writes the worker's current digests for the given path to the manifest (see encryption.h for the format)
+void write_manifest(std::ostream &manifest, const char *path, const ParallelCrypto &worker)
+{
+	const int digests = worker.getdigest(); // the enabled digests
+
+	// writes a single digest (or a placeholder if it's disabled)
+	auto put = [&manifest](bool enabled, std::uint32_t crc)
+	{
+		if (enabled) manifest << std::hex << std::setfill('0') << std::setw(8) << crc << std::dec << std::setfill(' ');
+		else manifest << "--------";
+	};
+
+	put(digests & ParallelCrypto::digest_input, worker.input_digest());
+	manifest << ' ';
+	put(digests & ParallelCrypto::digest_output, worker.output_digest());
+	manifest << ' ' << path << '\n';
+}
+
+bool cryptf(const char *in_path, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log, std::ostream *manifest)
 {
 	// open the files
 	std::ifstream in;
@@ -371,9 +427,12 @@ bool cryptf(const char *in_path, const char *out_path, ParallelCrypto &worker, c
 
 	// hand off to stream function
 	crypt(in, out, worker, buffer, buflen, log);
+
+	// record the digests (keyed by the output path, since that's what will be verified later)
+	if (manifest) write_manifest(*manifest, out_path, worker);
 	return true;
 }
-bool cryptf(const char *path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+bool cryptf(const char *path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log, std::ostream *manifest)
 {
 	// open the file
 	std::fstream f;
@@ -381,18 +440,33 @@ bool cryptf(const char *path, ParallelCrypto &worker, char *buffer, int buflen,
 
 	// hand off to stream function
 	crypt(f, f, worker, buffer, buflen, log);
+
+	// record the digests
+	if (manifest) write_manifest(*manifest, path, worker);
 	return true;
 }
 
-int cryptf_recursive(const char *root_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log)
+int cryptf_recursive(const char *root_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log, std::ostream *manifest, const char *skip_path)
 {
 	int successes = 0; // number of successful operations
 
+	// only a file that exists can be skipped, and only a file with the same name can be it - check these once up front
+	if (skip_path && !fs::exists(skip_path)) skip_path = nullptr;
+	const fs::path skip_name = skip_path ? fs::canonical(skip_path).filename() : fs::path(); // canonical gives the on-disk spelling
+
+	// returns true if the file should be left alone (e.g. it's the manifest we're writing to)
+	auto skip = [skip_path, &skip_name, log](const fs::path &path)
+	{
+		if (!skip_path || path.filename() != skip_name || !fs::equivalent(path, skip_path)) return false;
+
+		if (log) *log << "skipping \"" << path.generic_string() << "\"\n";
+		return true;
+	};
+
 	// if it's a file, process it
 	if (fs::is_regular_file(root_path))
 	{
-		
-		if (cryptf(root_path, worker, buffer, buflen, log)) ++successes;
+		if (!skip(root_path) && cryptf(root_path, worker, buffer, buflen, log, manifest)) ++successes;
 	}
 	// if it's a directory, process contents recursively
 	else if (fs::is_directory(root_path))
@@ -401,10 +475,10 @@ int cryptf_recursive(const char *root_path, ParallelCrypto &worker, char *buffer
 		for (const fs::directory_entry &entry : fs::recursive_directory_iterator(root_path))
 		{
 			// if this is a file 
-			if (fs::is_regular_file(entry.status()))
+			if (fs::is_regular_file(entry.status()) && !skip(entry.path()))
 			{
 				// hand off to cryptf
-				if (cryptf(entry.path().generic_string().c_str(), worker, buffer, buflen, log)) ++successes;
+				if (cryptf(entry.path().generic_string().c_str(), worker, buffer, buflen, log, manifest)) ++successes;
 			}
 		}
 	}
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <cstdint>
 
 // wraps crypto functions to process in parallel
 class ParallelCrypto
@@ -21,6 +22,9 @@ private: // -- helper types -- //
 	{
 		std::atomic<bool> has_data = false; // marks if this worker has work to do
 
+		std::uint32_t in_crc;  // crc32c of this worker's slice before processing (if enabled)
+		std::uint32_t out_crc; // crc32c of this worker's slice after processing (if enabled)
+
 		std::thread thread; // thread handle for the worker
 	};
 
@@ -41,6 +45,10 @@ private: // -- private data (self-managed) -- //
 	std::size_t            maskc;   // number of mask sets
 	std::size_t            maskoff; // mask set offset
 
+	int           digests;    // the digests to compute (digest flags or'd together)
+	std::uint32_t in_digest;  // running crc32c of all input since the last reset
+	std::uint32_t out_digest; // running crc32c of all output since the last reset
+
 public: // -- enums -- //
 
 	enum class mode
@@ -48,6 +56,12 @@ public: // -- enums -- //
 		encrypt, decrypt
 	};
 
+	// flags for which integrity digests to compute during processing
+	enum digest
+	{
+		digest_none = 0, digest_input = 1, digest_output = 2, digest_both = digest_input | digest_output
+	};
+
 public:
 
 	// initializes the parallel crypto for work with the given password and mode.
@@ -72,11 +86,27 @@ public:
 	// throws std::invalid_argument if key is null or empty
 	void setkey(const char *key);
 
+	// sets which crc32c digests are computed while processing (see the digest flags) - defaults to none.
+	// the digests are computed by each thread over its own slice while it is still in cache, so no second pass is required.
+	void setdigest(int d) noexcept;
+	// gets the digest flags set by setdigest()
+	int getdigest() const noexcept { return digests; }
+
+	// gets the crc32c digest of all input/output data processed since the last reset.
+	// returns 0 if the corresponding digest is not enabled.
+	std::uint32_t input_digest() const noexcept { return in_digest; }
+	std::uint32_t output_digest() const noexcept { return out_digest; }
+
 	// calls to process() remember the state after the last invocation to facilitate chunk processing.
 	// this function resets that state information.
 	// this should be used before processing a piece of unrelated information (e.g. a different file).
+	// also resets the input/output digests.
 	void reset() noexcept;
 
+	// sets the stream position of the next byte to be processed.
+	// this allows a piece of data to be processed starting from an arbitrary offset without processing everything before it.
+	void setpos(std::uint64_t pos) noexcept;
+
 	// processes the given data array in-place
 	// data  - data buffer to process
 	// start - index in array to begin
@@ -89,18 +119,24 @@ public:
 // encrypts or decrypts the input stream to the output stream
 // in     - the input stream
 // out    - the output stream
-// worker - the parallel crypto worker it use (should already be set up for use). maskoff is set to 0 before use
+// worker - the parallel crypto worker it use (should already be set up for use). maskoff is set to 0 before use.
+//          any enabled digests are left in the worker afterwards
 // buffer - the buffer to use for io/processing operations
 // buflen - the length of the buffer
 // log    - the destination for log messages (or null for no logging)
 void crypt(std::istream &in, std::ostream &out, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
 
+// the cryptf functions take an optional manifest stream. if non-null, a line is written for each processed file:
+// <input crc32c> <output crc32c> <path>
+// where each crc is 8 hex digits (or "--------" if that digest is not enabled in the worker).
+
 // encrypts or decrypts the input file to the output file. returns true if there were no errors
-bool cryptf(const char *in_path, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+bool cryptf(const char *in_path, const char *out_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr, std::ostream *manifest = nullptr);
 // encrypts or decrypts the specified file in-place. returns true if there were no errors
-bool cryptf(const char *path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+bool cryptf(const char *path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr, std::ostream *manifest = nullptr);
 
-// recursively encrypts or decrypts the contents of the specified path in-place. returns the number of successful operations
-int cryptf_recursive(const char *root_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr);
+// recursively encrypts or decrypts the contents of the specified path in-place. returns the number of successful operations.
+// if skip_path is non-null, that file is left untouched (e.g. the manifest being written to, if it lies within the tree)
+int cryptf_recursive(const char *root_path, ParallelCrypto &worker, char *buffer, int buflen, std::ostream *log = nullptr, std::ostream *manifest = nullptr, const char *skip_path = nullptr);
 
 #endif
@@ -3,7 +3,9 @@
 #include <fstream>
 #include <vector>
 #include <iomanip>
+#include <filesystem>
 #include "encryption.h"
+#include "archive.h"
 
 // size of buffer to create
 constexpr int buffer_size = 1024 * 1024;
@@ -21,6 +23,10 @@ void print_help(std::ostream &ostr)
 	ostr << "    -p <password>     specifies the password to use\n";
 	ostr << "    -r                processes files/directories in-place recursively\n";
 	ostr << "    -t                displays elapsed time after completion\n";
+	ostr << "    -c <manifest>     writes crc32c digests of the input and output of each file to manifest\n";
+	ostr << "    -a <archive>      with -e, packs all pathspecs into a single archive\n";
+	ostr << "                      with -d, extracts the archive into the first pathspec (a directory) -\n";
+	ostr << "                      any further pathspecs name the only members to extract\n";
 
 	ostr << '\n';
 }
@@ -49,12 +55,16 @@ int main(int argc, const char **argv)
 	#define __password { if (password) { std::cerr << "cannot respecify password\n"; return 0; } if (i + 1 >= argc) { std::cerr << "option " << argv[i] << " expected a password to follow\n"; return 0; } password = argv[++i]; }
 	#define __recursive { recursive = true; }
 	#define __time { time = true; }
+	#define __archive { if (archive_path) { std::cerr << "cannot respecify archive\n"; return 0; } if (i + 1 >= argc) { std::cerr << "option " << argv[i] << " expected an archive path to follow\n"; return 0; } archive_path = argv[++i]; }
+	#define __manifest { if (manifest_path) { std::cerr << "cannot respecify manifest\n"; return 0; } if (i + 1 >= argc) { std::cerr << "option " << argv[i] << " expected a manifest path to follow\n"; return 0; } manifest_path = argv[++i]; }
 
 	// -- parse terminal args -- //
 
 	bool                           recursive = false;  // flags that we're batch processing the files
 	bool                           time = false;       // flags that we're batch processing the files
 	const char                    *password = nullptr; // password to use
+	const char                    *manifest_path = nullptr; // path of the digest manifest to write (or null for none)
+	const char                    *archive_path = nullptr; // path of the archive to pack/extract (or null for none)
 	bool                           has_mode = false;   // marks if mode is valid
 	ParallelCrypto::mode           mode = ParallelCrypto::mode::encrypt; // crypto mode to use
 	std::vector<const char*>       paths;              // the provided paths
@@ -82,6 +92,8 @@ int main(int argc, const char **argv)
 				case 'p': __password; break;
 				case 'r': __recursive; break;
 				case 't': __time; break;
+				case 'c': __manifest; break;
+				case 'a': __archive; break;
 
 				// otherwise flag was unknown
 				default: std::cerr << "unknown option '" << *pos << "'. see -h for help\n"; return 0;
@@ -96,8 +108,31 @@ int main(int argc, const char **argv)
 	if (!has_mode) { std::cerr << "expected -e or -d. see -h for help\n"; return 0; }
 	if (!password) { std::cerr << "expected -p. see -h for help\n"; return 0; };
 
+	// archives are processed as a single stream, so per-file options don't apply
+	if (archive_path && (recursive || manifest_path)) { std::cerr << "-a cannot be combined with -r or -c. see -h for help\n"; return 0; }
+
+	// ensure a from-to copy got exactly 2 paths (checked before anything is opened or truncated)
+	if (!archive_path && !recursive && paths.size() != 2) { std::cerr << "non-recursive mode requires exactly 2 paths (input and output). see -h for help\n"; return 0; }
+
+	// opening the manifest truncates it, so make sure it isn't the input or output file of a from-to copy
+	if (manifest_path && !recursive)
+	{
+		namespace fs = std::filesystem;
+		for (const char *path : paths) if (fs::weakly_canonical(fs::absolute(path)) == fs::weakly_canonical(fs::absolute(manifest_path))) { std::cerr << "manifest cannot be the input or output file\n"; return 0; }
+	}
+
 	// generate the worker with the proper password and mode
 	ParallelCrypto worker(password, mode);
+
+	// if a manifest was requested, open it and enable digests
+	std::ofstream manifest;
+	if (manifest_path)
+	{
+		manifest = std::ofstream(manifest_path, std::ios::trunc);
+		if (!manifest.is_open()) { std::cerr << "failed to open manifest \"" << manifest_path << "\" for writing\n"; return 0; }
+
+		worker.setdigest(ParallelCrypto::digest_both);
+	}
 	
 	// create a buffer
 	std::unique_ptr<char[]> buffer = std::make_unique<char[]>(buffer_size);
@@ -105,20 +140,30 @@ int main(int argc, const char **argv)
 	// begin timing
 	auto start = std::chrono::high_resolution_clock::now();
 
+	// if packing/extracting an archive
+	if (archive_path)
+	{
+		// ensure there was at least one path specified
+		if (paths.empty()) { std::cerr << "archive mode requires at least one path. see -h for help\n"; return 0; }
+
+		// pack everything into the archive
+		if (mode == ParallelCrypto::mode::encrypt) cryptf_pack(archive_path, paths, worker, buffer.get(), buffer_size, &std::cout);
+		// extract everything into the output directory
+		else if (paths.size() == 1) cryptf_unpack(archive_path, paths[0], worker, buffer.get(), buffer_size, &std::cout);
+		// extract only the requested members (each only decrypts its own range of the archive)
+		else cryptf_extract(archive_path, std::vector<const char*>(paths.begin() + 1, paths.end()), paths[0], worker, buffer.get(), buffer_size, &std::cout);
+	}
 	// if recursive processing
-	if (recursive)
+	else if (recursive)
 	{
 		// process each pathspec recursively
-		for (std::size_t i = 0; i < paths.size(); ++i) cryptf_recursive(paths[i], worker, buffer.get(), buffer_size, &std::cout);
+		for (std::size_t i = 0; i < paths.size(); ++i) cryptf_recursive(paths[i], worker, buffer.get(), buffer_size, &std::cout, manifest_path ? &manifest : nullptr, manifest_path);
 	}
 	// otherwise doing from-to copy
 	else
 	{
-		// ensure there were exactly 2 paths specified
-		if (paths.size() != 2) { std::cerr << "non-recursive mode requires exactly 2 paths (input and output). see -h for help\n"; return 0; }
-
 		// process the file
-		cryptf(paths[0], paths[1], worker, buffer.get(), buffer_size, &std::cout);
+		cryptf(paths[0], paths[1], worker, buffer.get(), buffer_size, &std::cout, manifest_path ? &manifest : nullptr);
 	}
 
 	// display elapsed time if timing flag set